@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-KDE-Accepted-GPL
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#include <QElapsedTimer>
+#include <QTest>
+
+#include <algorithm>
+#include <cstring>
+
+#include "redirectiontracker.h"
+#include "syntheticrecords.h"
+
+using namespace SyntheticRecords;
+
+static constexpr uint32_t s_window = 0x2a00003;
+
+// Run by hand rather than through ctest, but still sized to stay well below
+// 100 MB of synthetic records
+static constexpr qsizetype s_records = 1'000'000;
+static constexpr int s_clients = 8192;
+static constexpr qsizetype s_batchSize = 4096;
+
+class RedirectionTrackerBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void benchmarkReplay();
+    void benchmarkDetection();
+
+private:
+    Stream m_stream;
+};
+
+void RedirectionTrackerBenchmark::initTestCase()
+{
+    m_stream = generate(s_records, s_clients, s_window);
+}
+
+void RedirectionTrackerBenchmark::benchmarkReplay()
+{
+    qsizetype flips = 0;
+    QElapsedTimer timer;
+    timer.start();
+    qint64 runs = 0;
+
+    QBENCHMARK {
+        RedirectionTracker tracker(s_window);
+        tracker.replay(m_stream.data, [&flips](qsizetype) {
+            ++flips;
+        });
+        ++runs;
+    }
+
+    const qint64 elapsed = timer.nsecsElapsed();
+    qInfo("%lld records in %lld runs, %.1f M records/s, %lld state changes", qint64(m_stream.records), runs,
+          double(m_stream.records) * runs * 1000.0 / elapsed, qint64(flips / runs));
+}
+
+// Time from handing the tracker the record that flips the redirect state to
+// getting told about it, i.e. what X11RecordingNotifier adds before it emits.
+// One handleRecord() call is far below what the clock resolves, so batches
+// are timed and each flip is charged the average cost of its batch.
+void RedirectionTrackerBenchmark::benchmarkDetection()
+{
+    RedirectionTracker tracker(s_window);
+    // handleRecord() needs each record aligned, replay() copies them out the
+    // same way
+    QByteArray record;
+    QElapsedTimer timer;
+    double flipNs = 0;
+    double maxFlipNs = 0;
+    qsizetype flips = 0;
+
+    for (QByteArrayView data = m_stream.data; !data.isEmpty();) {
+        qsizetype batchRecords = 0;
+        qsizetype batchFlips = 0;
+        timer.start();
+        for (; batchRecords < s_batchSize && !data.isEmpty(); ++batchRecords) {
+            xcb_record_enable_context_reply_t reply;
+            std::memcpy(&reply, data.data(), sizeof(reply));
+            const qsizetype size = RedirectionTracker::recordSize(reply);
+            record.resize(size);
+            std::memcpy(record.data(), data.data(), size);
+            if (tracker.handleRecord(*reinterpret_cast<const xcb_record_enable_context_reply_t *>(record.constData()))) {
+                ++batchFlips;
+            }
+            data = data.sliced(size);
+        }
+        const double perRecordNs = double(timer.nsecsElapsed()) / batchRecords;
+
+        if (batchFlips) {
+            flipNs += perRecordNs * batchFlips;
+            maxFlipNs = std::max(maxFlipNs, perRecordNs);
+            flips += batchFlips;
+        }
+    }
+
+    QCOMPARE(flips, m_stream.flips.size());
+    qInfo("%lld state changes, detected after %.1f ns on average, %.1f ns in the slowest batch of %lld records", qint64(flips),
+          flipNs / flips, maxFlipNs, qint64(s_batchSize));
+}
+
+QTEST_GUILESS_MAIN(RedirectionTrackerBenchmark)
+
+#include "redirectiontrackerbenchmark.moc"
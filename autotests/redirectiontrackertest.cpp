@@ -0,0 +1,176 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-KDE-Accepted-GPL
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#include <QTest>
+
+#include "redirectiontracker.h"
+#include "syntheticrecords.h"
+
+using namespace SyntheticRecords;
+
+static constexpr uint32_t s_window = 0x2a00003;
+
+class RedirectionTrackerTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testRedirectUnredirect();
+    void testNestedRedirects();
+    void testUnbalancedUnredirect();
+    void testOtherWindow();
+    void testClientDied();
+    void testShortRecord();
+    void testReplayTruncated();
+    void testStress();
+
+private:
+    static bool feed(RedirectionTracker &tracker, const QByteArray &data);
+};
+
+bool RedirectionTrackerTest::feed(RedirectionTracker &tracker, const QByteArray &data)
+{
+    const QByteArray record = firstRecord(data);
+    return tracker.handleRecord(*reinterpret_cast<const xcb_record_enable_context_reply_t *>(record.constData()));
+}
+
+void RedirectionTrackerTest::testRedirectUnredirect()
+{
+    RedirectionTracker tracker(s_window);
+    QVERIFY(!tracker.isRedirected());
+
+    QByteArray redirect;
+    appendRequest(redirect, clientXid(0), XCB_COMPOSITE_REDIRECT_WINDOW, s_window);
+    QVERIFY(feed(tracker, redirect));
+    QVERIFY(tracker.isRedirected());
+
+    // A single redirect followed by an unredirect leaves nobody redirecting
+    QByteArray unredirect;
+    appendRequest(unredirect, clientXid(0), XCB_COMPOSITE_UNREDIRECT_WINDOW, s_window);
+    QVERIFY(feed(tracker, unredirect));
+    QVERIFY(!tracker.isRedirected());
+}
+
+void RedirectionTrackerTest::testNestedRedirects()
+{
+    RedirectionTracker tracker(s_window);
+
+    QByteArray redirect;
+    appendRequest(redirect, clientXid(0), XCB_COMPOSITE_REDIRECT_SUBWINDOWS, s_window);
+    QByteArray unredirect;
+    appendRequest(unredirect, clientXid(0), XCB_COMPOSITE_UNREDIRECT_SUBWINDOWS, s_window);
+
+    QVERIFY(feed(tracker, redirect));
+    QVERIFY(!feed(tracker, redirect));
+    QVERIFY(!feed(tracker, unredirect));
+    QVERIFY(tracker.isRedirected());
+    QVERIFY(feed(tracker, unredirect));
+    QVERIFY(!tracker.isRedirected());
+}
+
+void RedirectionTrackerTest::testUnbalancedUnredirect()
+{
+    RedirectionTracker tracker(s_window);
+
+    QByteArray unredirect;
+    appendRequest(unredirect, clientXid(0), XCB_COMPOSITE_UNREDIRECT_WINDOW, s_window);
+    QVERIFY(!feed(tracker, unredirect));
+    QVERIFY(!tracker.isRedirected());
+
+    // Must not have left a negative count behind that swallows the redirect
+    QByteArray redirect;
+    appendRequest(redirect, clientXid(0), XCB_COMPOSITE_REDIRECT_WINDOW, s_window);
+    QVERIFY(feed(tracker, redirect));
+    QVERIFY(tracker.isRedirected());
+}
+
+void RedirectionTrackerTest::testOtherWindow()
+{
+    RedirectionTracker tracker(s_window);
+
+    QByteArray redirect;
+    appendRequest(redirect, clientXid(0), XCB_COMPOSITE_REDIRECT_WINDOW, s_window + 1);
+    QVERIFY(!feed(tracker, redirect));
+    QVERIFY(!tracker.isRedirected());
+}
+
+void RedirectionTrackerTest::testClientDied()
+{
+    RedirectionTracker tracker(s_window);
+
+    QByteArray records;
+    appendRequest(records, clientXid(0), XCB_COMPOSITE_REDIRECT_WINDOW, s_window);
+    appendRequest(records, clientXid(0), XCB_COMPOSITE_REDIRECT_WINDOW, s_window);
+    appendRequest(records, clientXid(1), XCB_COMPOSITE_REDIRECT_WINDOW, s_window);
+    appendClientDied(records, clientXid(0));
+    appendClientDied(records, clientXid(1));
+
+    QList<qsizetype> flips;
+    QCOMPARE(tracker.replay(records, [&flips](qsizetype record) {
+        flips.append(record);
+    }),
+             qsizetype(5));
+    QCOMPARE(flips, (QList<qsizetype>{0, 4}));
+    QVERIFY(!tracker.isRedirected());
+}
+
+void RedirectionTrackerTest::testShortRecord()
+{
+    RedirectionTracker tracker(s_window);
+
+    // A client record without room for a Composite request must be ignored
+    // rather than read past its end
+    QByteArray record;
+    appendClientDied(record, clientXid(0));
+    auto reply = reinterpret_cast<xcb_record_enable_context_reply_t *>(record.data());
+    reply->category = FromClient;
+    QVERIFY(!tracker.handleRecord(*reply));
+
+    reply->length = 1;
+    record.append(4, '\0');
+    QVERIFY(!tracker.handleRecord(*reinterpret_cast<const xcb_record_enable_context_reply_t *>(record.constData())));
+    QVERIFY(!tracker.isRedirected());
+}
+
+void RedirectionTrackerTest::testReplayTruncated()
+{
+    QByteArray records;
+    appendRequest(records, clientXid(0), XCB_COMPOSITE_REDIRECT_WINDOW, s_window);
+    appendRequest(records, clientXid(1), XCB_COMPOSITE_REDIRECT_WINDOW, s_window);
+    const qsizetype complete = records.size();
+    appendRequest(records, clientXid(0), XCB_COMPOSITE_UNREDIRECT_WINDOW, s_window);
+
+    // Cut into the trailing record's data, then into its header
+    for (const qsizetype size : {records.size() - 1, complete + 8}) {
+        RedirectionTracker tracker(s_window);
+        QCOMPARE(tracker.replay(QByteArrayView(records).first(size)), qsizetype(2));
+        QVERIFY(tracker.isRedirected());
+    }
+
+    RedirectionTracker tracker(s_window);
+    QCOMPARE(tracker.replay(records), qsizetype(3));
+    QVERIFY(tracker.isRedirected());
+}
+
+void RedirectionTrackerTest::testStress()
+{
+    const Stream stream = generate(2'000'000, 4096, s_window);
+    QVERIFY(stream.flips.size() > 1000);
+
+    RedirectionTracker tracker(s_window);
+    QList<qsizetype> flips;
+    flips.reserve(stream.flips.size());
+    QCOMPARE(tracker.replay(stream.data, [&flips](qsizetype record) {
+        flips.append(record);
+    }),
+             stream.records);
+
+    // Every state change is reported right at the record causing it
+    QCOMPARE(flips, stream.flips);
+    QCOMPARE(tracker.isRedirected(), stream.redirected);
+}
+
+QTEST_GUILESS_MAIN(RedirectionTrackerTest)
+
+#include "redirectiontrackertest.moc"
@@ -0,0 +1,147 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-KDE-Accepted-GPL
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QRandomGenerator>
+
+#include <xcb/composite.h>
+#include <xcb/record.h>
+
+#include <cstring>
+
+namespace SyntheticRecords
+{
+
+// XRecord reply categories
+constexpr uint8_t FromClient = 1;
+constexpr uint8_t ClientDied = 3;
+
+// X servers hand out XID ranges per client, the record carries the base
+inline uint32_t clientXid(int client)
+{
+    return uint32_t(client + 1) << 21;
+}
+
+inline void appendRequest(QByteArray &out, uint32_t client, uint8_t minorOpcode, uint32_t window)
+{
+    xcb_record_enable_context_reply_t reply = {};
+    reply.response_type = 1; // X_Reply
+    reply.category = FromClient;
+    reply.xid_base = client;
+
+    xcb_composite_redirect_window_request_t request = {};
+    request.major_opcode = 142;
+    request.minor_opcode = minorOpcode;
+    request.length = sizeof(request) / 4;
+    request.window = window;
+
+    reply.length = sizeof(request) / 4;
+    out.append(reinterpret_cast<const char *>(&reply), sizeof(reply));
+    out.append(reinterpret_cast<const char *>(&request), sizeof(request));
+}
+
+inline void appendClientDied(QByteArray &out, uint32_t client)
+{
+    xcb_record_enable_context_reply_t reply = {};
+    reply.response_type = 1; // X_Reply
+    reply.category = ClientDied;
+    reply.xid_base = client;
+    out.append(reinterpret_cast<const char *>(&reply), sizeof(reply));
+}
+
+/// Aligned copy of the first record in @p data, for feeding handleRecord()
+inline QByteArray firstRecord(const QByteArray &data)
+{
+    xcb_record_enable_context_reply_t reply;
+    std::memcpy(&reply, data.constData(), sizeof(reply));
+    return data.left(sizeof(reply) + reply.length * 4);
+}
+
+struct Stream {
+    QByteArray data;
+    qsizetype records = 0;
+    /// Indices of the records after which the window's redirect state flips
+    QList<qsizetype> flips;
+    bool redirected = false;
+};
+
+/**
+ * A reproducible mix of redirects, unredirects and client deaths from
+ * @p clients clients. Most of it is noise: requests for other windows, and
+ * unredirects from clients that never redirected us. The clients that do
+ * redirect our window tend to let go again soon, so the redirect state keeps
+ * flipping. The expected outcome is computed alongside with a plain model.
+ */
+inline Stream generate(qsizetype records, int clients, uint32_t window, quint32 seed = 1)
+{
+    QRandomGenerator random(seed);
+    QHash<uint32_t, int> model;
+    QList<uint32_t> active;
+    Stream stream;
+    stream.data.reserve(records * (sizeof(xcb_record_enable_context_reply_t) + sizeof(xcb_composite_redirect_window_request_t)));
+
+    auto randomMinor = [&random](bool redirect) -> uint8_t {
+        if (redirect) {
+            return random.bounded(2) ? XCB_COMPOSITE_REDIRECT_WINDOW : XCB_COMPOSITE_REDIRECT_SUBWINDOWS;
+        }
+        return random.bounded(2) ? XCB_COMPOSITE_UNREDIRECT_WINDOW : XCB_COMPOSITE_UNREDIRECT_SUBWINDOWS;
+    };
+    auto forget = [&](uint32_t client) {
+        model.remove(client);
+        active.removeOne(client);
+    };
+
+    for (qsizetype i = 0; i < records; ++i) {
+        const bool wasRedirected = !model.isEmpty();
+        const int roll = random.bounded(100);
+
+        if (roll < 45) {
+            // Somebody else's window
+            appendRequest(stream.data, clientXid(random.bounded(clients)), randomMinor(random.bounded(2)), window + 1 + random.bounded(1000));
+        } else if (roll < 50) {
+            const uint32_t client = clientXid(random.bounded(clients));
+            appendClientDied(stream.data, client);
+            forget(client);
+        } else if (roll < 60) {
+            const uint32_t client = clientXid(random.bounded(clients));
+            appendRequest(stream.data, client, randomMinor(true), window);
+            if (model[client]++ == 0) {
+                active.append(client);
+            }
+        } else if (roll < 72 && !active.isEmpty()) {
+            const uint32_t client = active.at(random.bounded(active.size()));
+            if (random.bounded(10) == 0) {
+                appendClientDied(stream.data, client);
+                forget(client);
+            } else {
+                appendRequest(stream.data, client, randomMinor(false), window);
+                if (--model[client] == 0) {
+                    forget(client);
+                }
+            }
+        } else {
+            // Unredirect from a random client, usually one that never redirected us
+            const uint32_t client = clientXid(random.bounded(clients));
+            appendRequest(stream.data, client, randomMinor(false), window);
+            if (auto it = model.find(client); it != model.end() && --(*it) == 0) {
+                forget(client);
+            }
+        }
+
+        if (wasRedirected != !model.isEmpty()) {
+            stream.flips.append(i);
+        }
+    }
+
+    stream.records = records;
+    stream.redirected = !model.isEmpty();
+    return stream;
+}
+
+}
@@ -0,0 +1,213 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-KDE-Accepted-GPL
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#include "frameexporter.h"
+
+#include <QFile>
+#include <QSocketNotifier>
+#include <QStandardPaths>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "frameexportworker.h"
+#include "xwaylandvideobridge-frames.h"
+#include "xwaylandvideobridge_debug.h"
+
+FrameExporter::FrameExporter(MemoryBudget *memory, QObject *parent)
+    : QObject(parent)
+    , m_socketPath(QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation)
+                   + QLatin1Char('/') + QLatin1String(XVB_FRAMES_SOCKET_NAME))
+{
+    const QByteArray path = QFile::encodeName(m_socketPath);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (size_t(path.size()) >= sizeof(addr.sun_path)) {
+        qCWarning(XWAYLANDBRIDGE) << "Frame export socket path too long" << m_socketPath;
+        return;
+    }
+    std::memcpy(addr.sun_path, path.constData(), path.size());
+
+    m_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_socket < 0) {
+        qCWarning(XWAYLANDBRIDGE) << "Could not create frame export socket" << strerror(errno);
+        return;
+    }
+
+    if (!claimSocketPath(path)) {
+        close(m_socket);
+        m_socket = -1;
+        return;
+    }
+    if (bind(m_socket, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(m_socket, 4) < 0) {
+        qCWarning(XWAYLANDBRIDGE) << "Could not listen on" << m_socketPath << strerror(errno);
+        close(m_socket);
+        m_socket = -1;
+        return;
+    }
+
+    auto notifier = new QSocketNotifier(m_socket, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &FrameExporter::acceptClient);
+
+    m_thread.setObjectName(QStringLiteral("FrameExport"));
+    m_worker = new FrameExportWorker(m_clientCount, memory);
+    m_worker->moveToThread(&m_thread);
+    connect(m_worker, &FrameExportWorker::ringChanged, this, &FrameExporter::setRing);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread.start();
+
+    qCDebug(XWAYLANDBRIDGE) << "Exporting frames on" << m_socketPath;
+}
+
+FrameExporter::~FrameExporter()
+{
+    // The worker gets deleted on its own thread as that finishes
+    m_thread.quit();
+    m_thread.wait();
+    if (m_memfd >= 0) {
+        close(m_memfd);
+    }
+
+    for (auto it = m_clients.cbegin(); it != m_clients.cend(); ++it) {
+        delete it.value();
+        close(it.key());
+    }
+    if (m_socket >= 0) {
+        close(m_socket);
+        unlink(QFile::encodeName(m_socketPath).constData());
+    }
+}
+
+// Queued, so the GUI thread never waits for the worker to finish a frame.
+// Calls are handled in order, a stop() always lands before the next stream.
+void FrameExporter::setStream(int fd, uint nodeId)
+{
+    if (!m_worker) {
+        close(fd);
+        return;
+    }
+    QMetaObject::invokeMethod(m_worker, "setStream", Qt::QueuedConnection, Q_ARG(int, fd), Q_ARG(uint, nodeId));
+}
+
+void FrameExporter::stop()
+{
+    if (m_worker) {
+        QMetaObject::invokeMethod(m_worker, "stop", Qt::QueuedConnection);
+    }
+}
+
+// Only take over the socket if nobody is listening on it anymore, a second
+// bridge in the same session must not steal the first one's clients
+bool FrameExporter::claimSocketPath(const QByteArray &path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.constData(), path.size());
+
+    const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) {
+        qCWarning(XWAYLANDBRIDGE) << "Could not probe frame export socket" << strerror(errno);
+        return false;
+    }
+    const int ret = ::connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    const int error = errno;
+    close(probe);
+
+    if (ret == 0) {
+        qCWarning(XWAYLANDBRIDGE) << "Another bridge already exports frames on" << m_socketPath;
+        return false;
+    }
+    if (error == ECONNREFUSED) {
+        // Left behind by a bridge that did not shut down cleanly
+        unlink(path.constData());
+    }
+    return true;
+}
+
+void FrameExporter::acceptClient()
+{
+    int client;
+    while ((client = accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0) {
+        // Clients never talk to us, readable means they hung up
+        auto notifier = new QSocketNotifier(client, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated, this, [this, client] {
+            char buffer[64];
+            const ssize_t ret = recv(client, buffer, sizeof(buffer), 0);
+            if (ret > 0 || (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))) {
+                return;
+            }
+            removeClient(client);
+        });
+
+        m_clients.insert(client, notifier);
+        m_clientCount.store(m_clients.size(), std::memory_order_relaxed);
+        QMetaObject::invokeMethod(m_worker, "updateStream", Qt::QueuedConnection);
+
+        if (m_memfd >= 0) {
+            sendHello(client);
+        }
+    }
+}
+
+void FrameExporter::sendHello(int client)
+{
+    xvb_frames_hello hello = {XVB_FRAMES_MAGIC, XVB_FRAMES_VERSION, m_mapSize};
+    iovec iov = {&hello, sizeof(hello)};
+
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &m_memfd, sizeof(int));
+
+    if (sendmsg(client, &msg, MSG_NOSIGNAL) != ssize_t(sizeof(hello))) {
+        qCDebug(XWAYLANDBRIDGE) << "Dropping frame export client" << strerror(errno);
+        shutdown(client, SHUT_RDWR);
+    }
+}
+
+void FrameExporter::removeClient(int client)
+{
+    QSocketNotifier *notifier = m_clients.take(client);
+    if (!notifier) {
+        return;
+    }
+    m_clientCount.store(m_clients.size(), std::memory_order_relaxed);
+    QMetaObject::invokeMethod(m_worker, "updateStream", Qt::QueuedConnection);
+
+    // Unregister from the event loop before the fd number can be reused by
+    // the next accept. Deleted later as we are usually in its activated().
+    notifier->setEnabled(false);
+    notifier->deleteLater();
+    close(client);
+}
+
+void FrameExporter::setRing(int memfd, quint64 mapSize)
+{
+    if (m_memfd >= 0) {
+        close(m_memfd);
+    }
+    m_memfd = memfd;
+    m_mapSize = mapSize;
+    if (m_memfd < 0) {
+        return;
+    }
+
+    for (auto it = m_clients.cbegin(); it != m_clients.cend(); ++it) {
+        sendHello(it.key());
+    }
+}
+
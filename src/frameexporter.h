@@ -0,0 +1,53 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-KDE-Accepted-GPL
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QThread>
+
+#include <atomic>
+
+class FrameExportWorker;
+class MemoryBudget;
+class QSocketNotifier;
+
+/**
+ * Exports the bridged stream to local tools as a memfd backed ring of frames,
+ * see xwaylandvideobridge-frames.h for the client side.
+ *
+ * Handles the socket and its clients, the frames themselves are processed by
+ * a FrameExportWorker on a dedicated thread.
+ */
+class FrameExporter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameExporter(MemoryBudget *memory, QObject *parent = nullptr);
+    ~FrameExporter() override;
+
+    /// Takes ownership of @p fd
+    void setStream(int fd, uint nodeId);
+    void stop();
+
+private:
+    bool claimSocketPath(const QByteArray &path);
+    void acceptClient();
+    void sendHello(int client);
+    void removeClient(int client);
+    void setRing(int memfd, quint64 mapSize);
+
+    QString m_socketPath;
+    int m_socket = -1;
+    QHash<int /*fd*/, QSocketNotifier *> m_clients;
+    std::atomic<int> m_clientCount = 0;
+
+    QThread m_thread;
+    FrameExportWorker *m_worker = nullptr;
+
+    int m_memfd = -1;
+    quint64 m_mapSize = 0;
+};
@@ -0,0 +1,251 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-KDE-Accepted-GPL
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#include "frameexportworker.h"
+
+#include <PipeWireSourceStream>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <spa/param/video/raw.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "memorybudget.h"
+#include "xwaylandvideobridge-frames.h"
+#include "xwaylandvideobridge_debug.h"
+
+// Enough for a reader to finish copying one frame while the next is written,
+// fewer slots are used if the memory budget does not allow for that many
+static constexpr uint s_maxSlotCount = 3;
+
+// All formats the portal offers are 32 bits per pixel
+static constexpr int s_bytesPerPixel = 4;
+
+static quint64 monotonicNow()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return quint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+FrameExportWorker::FrameExportWorker(const std::atomic<int> &clientCount, MemoryBudget *memory)
+    : m_clientCount(clientCount)
+    , m_memory(memory)
+{
+}
+
+FrameExportWorker::~FrameExportWorker()
+{
+    stop();
+    releaseRing();
+}
+
+void FrameExportWorker::setStream(int fd, uint nodeId)
+{
+    stop();
+    m_fd = fd;
+    m_nodeId = nodeId;
+    updateStream();
+}
+
+void FrameExportWorker::stop()
+{
+    disconnectStream();
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void FrameExportWorker::updateStream()
+{
+    const bool wanted = m_fd >= 0 && m_clientCount.load(std::memory_order_relaxed) > 0;
+    if (wanted && !m_stream) {
+        connectStream();
+    } else if (!wanted && m_stream) {
+        disconnectStream();
+    }
+}
+
+void FrameExportWorker::connectStream()
+{
+    // Accept whatever the portal node already negotiated with the bridge's
+    // own source item, DMA-BUF included, rather than asking for a different
+    // kind of buffer on the same node. DMA-BUFs get downloaded here.
+    m_stream = new PipeWireSourceStream(this);
+    connect(m_stream, &PipeWireSourceStream::frameReceived, this, &FrameExportWorker::writeFrame);
+    connect(m_stream, &PipeWireSourceStream::streamParametersChanged, this, &FrameExportWorker::prepareRing);
+    // PipeWireCore connects with a copy of the fd, ours is closed in stop().
+    // Cores are kept per thread, this one has nothing to share with the GUI's.
+    if (!m_stream->createStream(m_nodeId, m_fd)) {
+        qCWarning(XWAYLANDBRIDGE) << "Could not connect frame export to node" << m_nodeId << m_stream->error();
+        disconnectStream();
+    }
+}
+
+void FrameExportWorker::disconnectStream()
+{
+    delete m_stream;
+    releaseRing();
+}
+
+void FrameExportWorker::prepareRing()
+{
+    // Have the ring, and with it the clients' hello, ready before the first
+    // frame: a static source may not send one for a long time. Sized for
+    // unpadded rows, as writeFrame() exports them.
+    const QSize size = m_stream ? m_stream->size() : QSize();
+    if (!size.isEmpty()) {
+        ensureRing(quint64(size.width()) * s_bytesPerPixel * size.height());
+    }
+}
+
+bool FrameExportWorker::ensureRing(quint64 frameSize)
+{
+    // Round slots up so each slot's sequence stays aligned for atomic access
+    const quint64 slotSize = (sizeof(xvb_frame) + frameSize + 63) & ~quint64(63);
+    // Also shrink the ring if the rest of the bridge grew past the budget
+    const qint64 available = m_memory->available(MemoryBudget::ExportRing);
+    if (m_header && m_header->slot_size >= slotSize && qint64(m_mapSize) <= available) {
+        return true;
+    }
+
+    releaseRing();
+
+    const quint64 slotCount = available < qint64(sizeof(xvb_frames_header))
+        ? 0
+        : std::min<quint64>(s_maxSlotCount, (available - sizeof(xvb_frames_header)) / slotSize);
+    if (slotCount == 0) {
+        if (m_unaffordableSlotSize != slotSize) {
+            qCWarning(XWAYLANDBRIDGE) << "Not exporting frames, a" << frameSize << "bytes frame does not fit in the memory budget";
+            m_unaffordableSlotSize = slotSize;
+        }
+        return false;
+    }
+    if (slotCount < s_maxSlotCount) {
+        qCInfo(XWAYLANDBRIDGE) << "Lowering frame export ring to" << slotCount << "slots to fit the memory budget";
+    }
+    m_unaffordableSlotSize = 0;
+
+    m_mapSize = sizeof(xvb_frames_header) + slotCount * slotSize;
+    m_memfd = memfd_create("xwaylandvideobridge-frames", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (m_memfd < 0 || ftruncate(m_memfd, m_mapSize) < 0) {
+        qCWarning(XWAYLANDBRIDGE) << "Could not allocate frame export ring" << strerror(errno);
+        releaseRing();
+        return false;
+    }
+    // Clients get the fd too, make sure none of them can pull the pages from under us
+    fcntl(m_memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+    void *map = mmap(nullptr, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_memfd, 0);
+    if (map == MAP_FAILED) {
+        qCWarning(XWAYLANDBRIDGE) << "Could not map frame export ring" << strerror(errno);
+        releaseRing();
+        return false;
+    }
+
+    m_header = static_cast<xvb_frames_header *>(map);
+    m_header->magic = XVB_FRAMES_MAGIC;
+    m_header->version = XVB_FRAMES_VERSION;
+    m_header->slot_count = slotCount;
+    m_header->slot_size = slotSize;
+
+    m_memory->set(MemoryBudget::ExportRing, m_mapSize);
+
+    Q_EMIT ringChanged(fcntl(m_memfd, F_DUPFD_CLOEXEC, 0), m_mapSize);
+    return true;
+}
+
+void FrameExportWorker::releaseRing()
+{
+    if (!m_header && m_memfd < 0) {
+        return;
+    }
+    if (m_header) {
+        std::atomic_ref(m_header->flags).fetch_or(XVB_FRAMES_FLAG_STALE, std::memory_order_release);
+        munmap(m_header, m_mapSize);
+        m_header = nullptr;
+    }
+    if (m_memfd >= 0) {
+        close(m_memfd);
+        m_memfd = -1;
+    }
+    m_mapSize = 0;
+    m_memory->set(MemoryBudget::ExportRing, 0);
+    Q_EMIT ringChanged(-1, 0);
+}
+
+void FrameExportWorker::writeFrame(const PipeWireFrame &frame)
+{
+    if (m_clientCount.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    const void *pixels = nullptr;
+    QSize size;
+    qint32 stride = 0;
+    uint32_t format = 0;
+    if (frame.dataFrame) {
+        const auto &data = *frame.dataFrame;
+        pixels = data.data;
+        size = data.size;
+        stride = data.stride;
+        format = data.format;
+    } else if (frame.dmabuf) {
+        if (m_image.size() != m_stream->size()) {
+            m_image = QImage(m_stream->size(), QImage::Format_RGBA8888_Premultiplied);
+        }
+        if (!m_dmaBufHandler.downloadFrame(m_image, frame)) {
+            qCDebug(XWAYLANDBRIDGE) << "Could not download DMA-BUF frame for export";
+            return;
+        }
+        pixels = m_image.constBits();
+        size = m_image.size();
+        stride = m_image.bytesPerLine();
+        format = SPA_VIDEO_FORMAT_RGBA;
+    } else {
+        return;
+    }
+
+    // Rows go out without the padding PipeWire may add to them, so every
+    // frame fits the ring prepareRing() sized from the stream size alone
+    const qint32 rowBytes = std::min(stride, size.width() * s_bytesPerPixel);
+    const quint64 bytes = quint64(rowBytes) * size.height();
+    if (!ensureRing(bytes)) {
+        return;
+    }
+
+    const quint64 sequence = ++m_sequence;
+    auto slot = xvb_frames_slot(m_header, sequence);
+
+    // Seqlock: readers discard the slot if its sequence changed while copying
+    std::atomic_ref slotSequence(slot->sequence);
+    slotSequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->pts_ns = frame.presentationTimestamp ? frame.presentationTimestamp->count() : monotonicNow();
+    slot->width = size.width();
+    slot->height = size.height();
+    slot->stride = rowBytes;
+    slot->format = format;
+    slot->size = bytes;
+    if (rowBytes == stride) {
+        std::memcpy(slot + 1, pixels, bytes);
+    } else {
+        auto dst = reinterpret_cast<char *>(slot + 1);
+        auto src = static_cast<const char *>(pixels);
+        for (int y = 0; y < size.height(); ++y) {
+            std::memcpy(dst + qsizetype(y) * rowBytes, src + qsizetype(y) * stride, rowBytes);
+        }
+    }
+
+    slotSequence.store(sequence, std::memory_order_release);
+    std::atomic_ref(m_header->last_sequence).store(sequence, std::memory_order_release);
+}
@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-KDE-Accepted-GPL
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#pragma once
+
+#include <QImage>
+#include <QObject>
+#include <QPointer>
+
+#include <DmaBufHandler>
+
+#include <atomic>
+
+class MemoryBudget;
+class PipeWireSourceStream;
+struct PipeWireFrame;
+struct xvb_frames_header;
+
+/**
+ * Dequeues the frames of one PipeWire stream and copies them into the export
+ * ring. Lives on its own thread so a large source never holds up the GUI
+ * thread, which renders the bridge window and talks to the portal.
+ *
+ * The ring is the hand-off to readers: a single producer writes slots in
+ * turn without ever waiting for them, so the oldest frame is what gets
+ * dropped when readers fall behind.
+ */
+class FrameExportWorker : public QObject
+{
+    Q_OBJECT
+public:
+    FrameExportWorker(const std::atomic<int> &clientCount, MemoryBudget *memory);
+    ~FrameExportWorker() override;
+
+    /// Takes ownership of @p fd
+    Q_INVOKABLE void setStream(int fd, uint nodeId);
+    Q_INVOKABLE void stop();
+
+    /// The stream is only connected while there are clients to read it
+    Q_INVOKABLE void updateStream();
+
+Q_SIGNALS:
+    /// @p memfd is a copy owned by the receiver, -1 once the ring is gone
+    void ringChanged(int memfd, quint64 mapSize);
+
+private:
+    void connectStream();
+    void disconnectStream();
+    void prepareRing();
+    void writeFrame(const PipeWireFrame &frame);
+    bool ensureRing(quint64 frameSize);
+    void releaseRing();
+
+    const std::atomic<int> &m_clientCount;
+    MemoryBudget *const m_memory;
+    QPointer<PipeWireSourceStream> m_stream;
+    int m_fd = -1;
+    uint m_nodeId = 0;
+    DmaBufHandler m_dmaBufHandler;
+    QImage m_image;
+
+    int m_memfd = -1;
+    quint64 m_mapSize = 0;
+    xvb_frames_header *m_header = nullptr;
+    quint64 m_sequence = 0;
+    quint64 m_unaffordableSlotSize = 0;
+};
@@ -7,21 +7,39 @@
 
 #include "version.h"
 #include "xwaylandvideobridge.h"
+#include "xwaylandvideobridge_debug.h"
 
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QElapsedTimer>
 #include <QIcon>
 #include <QSessionManager>
+#include <QTextStream>
 
 #include <KAboutData>
 #include <KCrash>
 #include <KLocalizedString>
 
+#include <limits>
+
+#include <sys/resource.h>
+
+static qint64 cpuTimeMs()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+}
+
 int main(int argc, char **argv)
 {
     if (qgetenv("XDG_SESSION_TYPE") == "x11")
         return 0;
 
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+
     qputenv("QT_QPA_PLATFORM", "xcb");
     qputenv("QT_XCB_GL_INTEGRATION", "xcb_egl");
     qputenv("QT_QPA_UPDATE_IDLE_TIME", "0");
@@ -60,10 +78,52 @@ int main(int argc, char **argv)
 
     QCommandLineParser parser;
     about.setupCommandLine(&parser);
+    const QCommandLineOption exportFramesOption(
+        QStringLiteral("export-frames"),
+        i18n("Share the bridged frames with local tools over shared memory"));
+    parser.addOption(exportFramesOption);
+    const QCommandLineOption memoryBudgetOption(
+        QStringLiteral("memory-budget"),
+        i18n("Limit the frame export so that all frame buffers stay within this many MiB"),
+        i18n("MiB"));
+    parser.addOption(memoryBudgetOption);
     parser.process(app);
     about.processCommandLine(&parser);
 
-    new XwaylandVideoBridge(&app);
+    qint64 memoryBudget = 0;
+    if (parser.isSet(memoryBudgetOption)) {
+        bool ok = false;
+        const qint64 mib = parser.value(memoryBudgetOption).toLongLong(&ok);
+        if (!ok || mib <= 0 || mib > std::numeric_limits<qint64>::max() / (1024 * 1024)) {
+            qCritical().noquote() << i18n("Invalid memory budget \"%1\", expected a positive number of MiB",
+                                          parser.value(memoryBudgetOption));
+            return 1;
+        }
+        memoryBudget = mib * 1024 * 1024;
+    }
+
+    auto *bridge = new XwaylandVideoBridge(&app);
+    bridge->setMemoryBudget(memoryBudget);
+    bridge->setFrameExportEnabled(parser.isSet(exportFramesOption));
+    qCDebug(XWAYLANDBRIDGE) << "Bridge window ready after"
+                            << startupTimer.elapsed() << "ms";
+
+    // Developer measurement, not an option: wall and CPU time until the
+    // bridge window exists, as happens at every login, and then what the
+    // deferred tray icon costs on top.
+    if (qEnvironmentVariableIsSet("XWAYLANDVIDEOBRIDGE_STARTUP_BENCHMARK")) {
+        QTextStream out(stdout);
+        out << "window_ms " << startupTimer.elapsed() << '\n';
+        out << "window_cpu_ms " << cpuTimeMs() << '\n';
+
+        QElapsedTimer trayTimer;
+        trayTimer.start();
+        const qint64 cpuBeforeTray = cpuTimeMs();
+        bridge->ensureTrayIcon();
+        out << "tray_ms " << trayTimer.elapsed() << '\n';
+        out << "tray_cpu_ms " << cpuTimeMs() - cpuBeforeTray << '\n';
+        return 0;
+    }
 
     return app.exec();
 }
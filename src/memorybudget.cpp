@@ -0,0 +1,104 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-KDE-Accepted-GPL
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#include "memorybudget.h"
+
+#include <QLocale>
+#include <QMetaEnum>
+#include <QStringList>
+
+#include <algorithm>
+#include <limits>
+
+#include "xwaylandvideobridge_debug.h"
+
+static QString categoryName(MemoryBudget::Category category)
+{
+    return QString::fromLatin1(QMetaEnum::fromType<MemoryBudget::Category>().valueToKey(category));
+}
+
+static QString formatBytes(qint64 bytes)
+{
+    return QLocale::c().formattedDataSize(bytes);
+}
+
+MemoryBudget::MemoryBudget(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void MemoryBudget::setBudget(qint64 bytes)
+{
+    m_budget = bytes;
+    qCDebug(XWAYLANDBRIDGE) << "Memory budget set to" << (bytes ? formatBytes(bytes) : QStringLiteral("unlimited"));
+}
+
+qint64 MemoryBudget::budget() const
+{
+    return m_budget;
+}
+
+qint64 MemoryBudget::available(Category category) const
+{
+    const qint64 budget = m_budget;
+    if (!budget) {
+        return std::numeric_limits<qint64>::max();
+    }
+    return std::max<qint64>(0, budget - (total() - current(category)));
+}
+
+void MemoryBudget::set(Category category, qint64 bytes)
+{
+    const qint64 previous = m_current[category].exchange(bytes);
+    if (previous == bytes) {
+        return;
+    }
+
+    qint64 peak = m_peak[category];
+    while (bytes > peak && !m_peak[category].compare_exchange_weak(peak, bytes)) { }
+
+    qCDebug(XWAYLANDBRIDGE) << "Memory used by" << categoryName(category) << formatBytes(bytes)
+                            << "peak" << formatBytes(std::max(peak, bytes));
+
+    const qint64 budget = m_budget;
+    if (budget && bytes > previous && total() > budget) {
+        qCWarning(XWAYLANDBRIDGE) << "Memory budget of" << formatBytes(budget) << "exceeded by" << categoryName(category)
+                                  << "now using" << formatBytes(total());
+    }
+}
+
+qint64 MemoryBudget::current(Category category) const
+{
+    return m_current[category];
+}
+
+qint64 MemoryBudget::peak(Category category) const
+{
+    return m_peak[category];
+}
+
+qint64 MemoryBudget::total() const
+{
+    qint64 total = 0;
+    for (const auto &current : m_current) {
+        total += current;
+    }
+    return total;
+}
+
+QString MemoryBudget::report() const
+{
+    QStringList lines;
+    for (int i = 0; i < CategoryCount; ++i) {
+        const auto category = static_cast<Category>(i);
+        lines << QStringLiteral("%1: %2 (peak %3)").arg(categoryName(category), formatBytes(current(category)), formatBytes(peak(category)));
+    }
+    const qint64 budget = m_budget;
+    lines << QStringLiteral("Total: %1 of %2").arg(formatBytes(total()), budget ? formatBytes(budget) : QStringLiteral("unlimited"));
+
+    const QString report = lines.join(QLatin1Char('\n'));
+    qCInfo(XWAYLANDBRIDGE).noquote() << "Memory usage\n" << report;
+    return report;
+}
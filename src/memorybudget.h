@@ -0,0 +1,57 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-KDE-Accepted-GPL
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#pragma once
+
+#include <QObject>
+
+#include <array>
+#include <atomic>
+
+/**
+ * Keeps count of the memory the bridge's frame buffers take up, per category,
+ * and of the budget they have to fit in. Safe to update from any thread.
+ *
+ * Only the ExportRing is sized to fit, the other categories are estimates of
+ * buffers owned by Qt and KPipeWire that merely count against the budget.
+ *
+ * Exported on the session bus as /MemoryUsage so the numbers can be fetched
+ * on demand.
+ */
+class MemoryBudget : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.xwaylandvideobridge.MemoryUsage")
+public:
+    enum Category {
+        Window, ///< Estimated backing store of the bridge window
+        StreamTexture, ///< Estimated texture of the on-screen stream
+        ExportRing, ///< Frame export ring, see FrameExportWorker
+    };
+    Q_ENUM(Category)
+    static constexpr int CategoryCount = ExportRing + 1;
+
+    explicit MemoryBudget(QObject *parent = nullptr);
+
+    /// 0 means unlimited
+    void setBudget(qint64 bytes);
+    qint64 budget() const;
+
+    /// How many bytes @p category may use in total without exceeding the budget
+    qint64 available(Category category) const;
+
+    void set(Category category, qint64 bytes);
+    qint64 current(Category category) const;
+    qint64 peak(Category category) const;
+    qint64 total() const;
+
+public Q_SLOTS:
+    Q_SCRIPTABLE QString report() const;
+
+private:
+    std::atomic<qint64> m_budget = 0;
+    std::array<std::atomic<qint64>, CategoryCount> m_current = {};
+    std::array<std::atomic<qint64>, CategoryCount> m_peak = {};
+};
@@ -0,0 +1,101 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-KDE-Accepted-GPL
+ * SPDX-FileCopyrightText: 2023 David Edmundson <kde@davidedmundson.co.uk>
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#include "redirectiontracker.h"
+
+#include <xcb/composite.h>
+
+#include <cstring>
+
+// XRecord reply categories, xcb has no names for them
+enum RecordCategory {
+    FromServer = 0,
+    FromClient = 1,
+    ClientStarted = 2,
+    ClientDied = 3,
+};
+
+RedirectionTracker::RedirectionTracker(uint32_t window)
+    : m_window(window)
+{
+}
+
+bool RedirectionTracker::isRedirected() const
+{
+    return !m_redirectionCount.isEmpty();
+}
+
+qsizetype RedirectionTracker::recordSize(const xcb_record_enable_context_reply_t &reply)
+{
+    return sizeof(reply) + qsizetype(reply.length) * 4;
+}
+
+bool RedirectionTracker::handleRecord(const xcb_record_enable_context_reply_t &reply)
+{
+    const bool wasRedirected = isRedirected();
+
+    if (reply.category == ClientDied) {
+        m_redirectionCount.remove(reply.xid_base);
+        return isRedirected() != wasRedirected;
+    }
+
+    if (reply.category != FromClient) {
+        return false;
+    }
+
+    if (reply.length * 4 < sizeof(xcb_composite_redirect_window_request_t)) {
+        return false;
+    }
+
+    auto request = reinterpret_cast<const xcb_composite_redirect_window_request_t *>(xcb_record_enable_context_data(&reply));
+    if (request->window != m_window) {
+        return false;
+    }
+
+    const uint32_t caller = reply.xid_base;
+    switch (request->minor_opcode) {
+    case XCB_COMPOSITE_REDIRECT_WINDOW:
+    case XCB_COMPOSITE_REDIRECT_SUBWINDOWS:
+        m_redirectionCount[caller]++;
+        break;
+    case XCB_COMPOSITE_UNREDIRECT_WINDOW:
+    case XCB_COMPOSITE_UNREDIRECT_SUBWINDOWS: {
+        auto it = m_redirectionCount.find(caller);
+        if (it != m_redirectionCount.end() && --(*it) <= 0) {
+            m_redirectionCount.erase(it);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    return isRedirected() != wasRedirected;
+}
+
+qsizetype RedirectionTracker::replay(QByteArrayView data, const std::function<void(qsizetype record)> &changed)
+{
+    qsizetype count = 0;
+    // Records are not necessarily aligned within the capture, copy them out
+    QByteArray record;
+    while (data.size() >= qsizetype(sizeof(xcb_record_enable_context_reply_t))) {
+        xcb_record_enable_context_reply_t header;
+        std::memcpy(&header, data.data(), sizeof(header));
+        const qsizetype size = recordSize(header);
+        if (data.size() < size) {
+            break;
+        }
+
+        record.resize(size);
+        std::memcpy(record.data(), data.data(), size);
+        if (handleRecord(*reinterpret_cast<const xcb_record_enable_context_reply_t *>(record.constData())) && changed) {
+            changed(count);
+        }
+        data = data.sliced(size);
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,44 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-KDE-Accepted-GPL
+ * SPDX-FileCopyrightText: 2023 David Edmundson <kde@davidedmundson.co.uk>
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#pragma once
+
+#include <QByteArrayView>
+#include <QHash>
+#include <xcb/record.h>
+
+#include <functional>
+
+/**
+ * Keeps track of which X clients redirect a window, fed with the raw
+ * XRecord replies of Composite requests. Independent of any X connection so
+ * that captured record streams can be replayed offline.
+ */
+class RedirectionTracker
+{
+public:
+    explicit RedirectionTracker(uint32_t window);
+
+    bool isRedirected() const;
+
+    /// Returns true if isRedirected() changed
+    bool handleRecord(const xcb_record_enable_context_reply_t &reply);
+
+    /**
+     * Feeds back-to-back records as they came off the wire, e.g. a capture
+     * written with XWAYLANDVIDEOBRIDGE_RECORD_CAPTURE. @p changed is called
+     * with the index of the record that made isRedirected() flip. Returns the
+     * number of records consumed, a truncated trailing record is ignored.
+     */
+    qsizetype replay(QByteArrayView data, const std::function<void(qsizetype record)> &changed = {});
+
+    /// Size of @p reply including its trailing data
+    static qsizetype recordSize(const xcb_record_enable_context_reply_t &reply);
+
+private:
+    uint32_t m_window;
+    QHash<uint32_t /**called XID*/, int /*count*/> m_redirectionCount;
+};
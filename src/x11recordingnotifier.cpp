@@ -21,8 +21,8 @@
 
 #include <QScopedPointer>
 #include <QDebug>
+#include <QFile>
 #include <QSocketNotifier>
-#include <QScopeGuard>
 
 struct XCBResponse
 {
@@ -43,7 +43,23 @@ XCBResponse::~XCBResponse() {
 X11RecordingNotifier::X11RecordingNotifier(WId window, QObject *parent)
     : QObject(parent)
     , m_windowId(window)
+    , m_tracker(window)
 {
+}
+
+void X11RecordingNotifier::start()
+{
+    // Dump every record we get, so odd client behaviour can be replayed
+    // offline through RedirectionTracker::replay()
+    const QString capturePath = qEnvironmentVariable("XWAYLANDVIDEOBRIDGE_RECORD_CAPTURE");
+    if (!capturePath.isEmpty()) {
+        m_capture.reset(new QFile(capturePath));
+        if (!m_capture->open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "Could not open record capture" << capturePath << m_capture->errorString();
+            m_capture.reset();
+        }
+    }
+
     // we use a separate connection as the X11 recording API blocks is super weird
     // and we get multiple replies to a request rather than events
     m_connection = xcb_connect(nullptr, nullptr);
@@ -130,52 +146,14 @@ X11RecordingNotifier::~X11RecordingNotifier()
     }
 }
 
-bool X11RecordingNotifier::isRedirected() const
-{
-    return !m_redirectionCount.isEmpty();
-}
-
 void X11RecordingNotifier::handleNewRecord(xcb_record_enable_context_reply_t &reply)
 {
-    const bool wasRedirected = isRedirected();
-    auto cleanup = qScopeGuard([wasRedirected, this] {
-        if (isRedirected() != wasRedirected) {
-            Q_EMIT isRedirectedChanged();
-        }
-    });
-
-    if (reply.category == 3) {
-        m_redirectionCount.remove(reply.xid_base);
-        return;
-    }
-
-    if (reply.category != 1) {
-        return;
-    }
-
-    xcb_composite_redirect_window_request_t *request = reinterpret_cast<xcb_composite_redirect_window_request_t *>(xcb_record_enable_context_data(&reply));
-
-    if (!request) {
-        return;
-    }
-
-    if (request->window != m_windowId) {
-        return;
+    if (m_capture) {
+        m_capture->write(reinterpret_cast<const char *>(&reply), RedirectionTracker::recordSize(reply));
+        m_capture->flush();
     }
 
-    uint32_t caller = reply.xid_base;
-    switch(request->minor_opcode) {
-    case XCB_COMPOSITE_REDIRECT_WINDOW:
-    case XCB_COMPOSITE_REDIRECT_SUBWINDOWS:
-        m_redirectionCount[caller]++;
-        break;
-    case XCB_COMPOSITE_UNREDIRECT_WINDOW:
-    case XCB_COMPOSITE_UNREDIRECT_SUBWINDOWS:
-        if (m_redirectionCount[caller]-- == 0) {
-            m_redirectionCount.remove(caller);
-        }
-        break;
-    default:
-        break;
+    if (m_tracker.handleRecord(reply)) {
+        Q_EMIT isRedirectedChanged(m_tracker.isRedirected());
     }
 }
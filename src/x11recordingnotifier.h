@@ -6,26 +6,36 @@
 
 #pragma once
 
-#include <QHash>
 #include <QObject>
+#include <QScopedPointer>
 #include <QWindow>
 #include <xcb/record.h>
 
+#include "redirectiontracker.h"
+
+class QFile;
+
+/**
+ * Watches the Composite requests of all X clients for redirects of our window.
+ * Meant to live on its own thread, as XRecord hands us every such request on
+ * the display: call start() once it got moved there.
+ */
 class X11RecordingNotifier : public QObject
 {
     Q_OBJECT
 public:
-    X11RecordingNotifier(WId window, QObject *parent);
+    explicit X11RecordingNotifier(WId window, QObject *parent = nullptr);
     ~X11RecordingNotifier();
 
-    bool isRedirected() const;
+    void start();
 Q_SIGNALS:
-    void isRedirectedChanged();
+    void isRedirectedChanged(bool redirected);
 private:
     void handleNewRecord(xcb_record_enable_context_reply_t &reply);
 
     xcb_connection_t *m_connection = nullptr;
     xcb_record_context_t m_recordingContext = 0;
     WId m_windowId = 0; // my xterm
-    QHash<uint32_t /**called XID*/, int /*count*/> m_redirectionCount;
+    RedirectionTracker m_tracker;
+    QScopedPointer<QFile> m_capture;
 };
@@ -0,0 +1,180 @@
+/*
+ * Client side of the xwaylandvideobridge frame export.
+ *
+ * When started with --export-frames the bridge listens on
+ * $XDG_RUNTIME_DIR/xwaylandvideobridge-frames. Every connected client is sent
+ * a struct xvb_frames_hello together with a memfd (SCM_RIGHTS) holding a ring
+ * of the most recent frames of the bridged stream. A new hello is sent
+ * whenever the ring has to be reallocated, after the old one got flagged with
+ * XVB_FRAMES_FLAG_STALE. Only one bridge per session exports frames, a second
+ * one leaves the socket to the bridge already listening on it.
+ *
+ * The bridge only connects to the stream while at least one client is
+ * connected, so the first hello arrives once that stream has negotiated its
+ * size. Without an active screencast session there is no stream, and
+ * xvb_frames_receive() waits until a session starts.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ * SPDX-FileCopyrightText: 2026 Hadi Chokr <hadichokr@icloud.com>
+ */
+
+#ifndef XWAYLANDVIDEOBRIDGE_FRAMES_H
+#define XWAYLANDVIDEOBRIDGE_FRAMES_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XVB_FRAMES_SOCKET_NAME "xwaylandvideobridge-frames"
+#define XVB_FRAMES_MAGIC 0x46425658u /* "XVBF" */
+#define XVB_FRAMES_VERSION 1u
+
+/* Set once the bridge moved on to a new ring, wait for the next hello */
+#define XVB_FRAMES_FLAG_STALE 1u
+
+struct xvb_frames_hello {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t map_size;
+};
+
+struct xvb_frames_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t slot_count;
+    uint64_t slot_size; /* bytes per slot, including struct xvb_frame */
+    uint64_t last_sequence; /* last completed frame, 0 if there is none */
+};
+
+/*
+ * Frame n lives in slot n % slot_count. Its sequence is 0 while the bridge
+ * writes to the slot, readers must check it before and after copying.
+ */
+struct xvb_frame {
+    uint64_t sequence;
+    uint64_t pts_ns; /* presentation timestamp, CLOCK_MONOTONIC */
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride; /* bytes per row, rows carry no padding beyond 4 bytes per pixel */
+    uint32_t format; /* enum spa_video_format, SPA_VIDEO_FORMAT_RGBA for DMA-BUF sources */
+    uint64_t size; /* bytes of pixel data following this struct */
+};
+
+static inline struct xvb_frame *xvb_frames_slot(struct xvb_frames_header *header, uint64_t sequence)
+{
+    return (struct xvb_frame *)((char *)header + sizeof(*header) + (sequence % header->slot_count) * header->slot_size);
+}
+
+/* Returns the connected socket, or -1 */
+static inline int xvb_frames_connect(void)
+{
+    const char *runtimeDir = getenv("XDG_RUNTIME_DIR");
+    struct sockaddr_un addr;
+    int fd;
+
+    if (!runtimeDir)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if ((size_t)snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/" XVB_FRAMES_SOCKET_NAME, runtimeDir) >= sizeof(addr.sun_path))
+        return -1;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Blocks until the next hello and maps the ring it announces, or returns NULL */
+static inline struct xvb_frames_header *xvb_frames_receive(int socket, uint64_t *map_size)
+{
+    struct xvb_frames_hello hello;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = {&hello, sizeof(hello)};
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    void *map;
+    int memfd = -1;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(socket, &msg, MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(hello))
+        return NULL;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            memcpy(&memfd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    if (memfd < 0)
+        return NULL;
+    if (hello.magic != XVB_FRAMES_MAGIC || hello.version != XVB_FRAMES_VERSION) {
+        close(memfd);
+        return NULL;
+    }
+
+    map = mmap(NULL, hello.map_size, PROT_READ, MAP_SHARED, memfd, 0);
+    close(memfd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    *map_size = hello.map_size;
+    return (struct xvb_frames_header *)map;
+}
+
+/*
+ * Copies the newest frame into frame/pixels if it is newer than *last_seen.
+ * Returns 1 on success, 0 if there is nothing new or the frame got
+ * overwritten while copying, -1 if pixels is too small or the ring is stale.
+ */
+static inline int xvb_frames_read_latest(struct xvb_frames_header *header, uint64_t *last_seen, struct xvb_frame *frame, void *pixels, size_t pixels_size)
+{
+    const uint64_t sequence = __atomic_load_n(&header->last_sequence, __ATOMIC_ACQUIRE);
+    struct xvb_frame *slot;
+
+    if (__atomic_load_n(&header->flags, __ATOMIC_ACQUIRE) & XVB_FRAMES_FLAG_STALE)
+        return -1;
+    if (sequence == 0 || sequence == *last_seen)
+        return 0;
+
+    slot = xvb_frames_slot(header, sequence);
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != sequence)
+        return 0;
+
+    memcpy(frame, slot, sizeof(*frame));
+    if (frame->size > pixels_size)
+        return -1;
+    memcpy(pixels, slot + 1, frame->size);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != sequence)
+        return 0;
+
+    frame->sequence = sequence;
+    *last_seen = sequence;
+    return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -10,6 +10,10 @@
 #include "xwaylandvideobridge.h"
 
 #include <QAction>
+#include <QDBusConnectionInterface>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QElapsedTimer>
 #include <QGuiApplication>
 #include <QLoggingCategory>
 #include <QMenu>
@@ -21,13 +25,27 @@
 
 #include <PipeWireSourceItem>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "contentswindow.h"
+#include "frameexporter.h"
+#include "memorybudget.h"
 #include "x11recordingnotifier.h"
 #include "xdp_dbus_screencast_interface.h"
 #include "xwaylandvideobridge_debug.h"
 
 Q_DECLARE_METATYPE(Stream)
 
+using namespace std::chrono_literals;
+
+// How long a stream may go without buffers before we try to recover it
+static constexpr auto s_stallThreshold = 3s;
+
+// When to create the tray icon and export memory usage if no session needed
+// them before
+static constexpr auto s_deferredSetupDelay = 30s;
+
 QDebug operator<<(QDebug debug, const Stream &stream)
 {
     QDebugStateSaver saver(debug);
@@ -83,24 +101,40 @@ static QString streamTitle(const Stream &stream)
 
 XwaylandVideoBridge::XwaylandVideoBridge(QObject *parent)
 : QObject(parent)
-, iface(new OrgFreedesktopPortalScreenCastInterface(
-    QLatin1String("org.freedesktop.portal.Desktop"),
-                                                    QLatin1String("/org/freedesktop/portal/desktop"),
-                                                    QDBusConnection::sessionBus(), this))
 , m_handleToken(QStringLiteral("xwaylandvideobridge%1")
 .arg(QRandomGenerator::global()->generate()))
 , m_quitTimer(new QTimer(this))
 , m_window(new ContentsWindow)
+, m_watchdog(new QTimer(this))
+, m_memory(new MemoryBudget(this))
 {
     m_quitTimer->setInterval(5000);
     m_quitTimer->setSingleShot(true);
     connect(m_quitTimer, &QTimer::timeout, this,
             &XwaylandVideoBridge::closeSession);
 
-    auto *notifier = new X11RecordingNotifier(m_window->winId(), this);
-    connect(notifier, &X11RecordingNotifier::isRedirectedChanged, this,
-            [this, notifier]() {
-                if (notifier->isRedirected()) {
+    m_watchdog->setInterval(s_stallThreshold);
+    m_watchdog->setSingleShot(true);
+    connect(m_watchdog, &QTimer::timeout, this,
+            &XwaylandVideoBridge::recoverStream);
+
+    // Double buffered, 4 bytes per pixel
+    const QSize windowSize = m_window->size() * m_window->devicePixelRatio();
+    m_memory->set(MemoryBudget::Window, qint64(windowSize.width()) * windowSize.height() * 4 * 2);
+
+    // Every Composite request on the display comes through XRecord, keep
+    // them off the thread that renders the bridge window and talks to the
+    // portal. Connecting to X for it no longer holds up startup either.
+    m_notifier = new X11RecordingNotifier(m_window->winId());
+    m_notifier->moveToThread(&m_recordingThread);
+    connect(&m_recordingThread, &QThread::started, m_notifier,
+            &X11RecordingNotifier::start);
+    connect(&m_recordingThread, &QThread::finished, m_notifier,
+            &QObject::deleteLater);
+    connect(m_notifier, &X11RecordingNotifier::isRedirectedChanged, this,
+            [this](bool redirected) {
+                m_redirected = redirected;
+                if (redirected) {
                     m_quitTimer->stop();
                     if (m_path.path().isEmpty())
                         init();
@@ -108,10 +142,78 @@ XwaylandVideoBridge::XwaylandVideoBridge(QObject *parent)
                     m_quitTimer->start();
                 }
             });
+    m_recordingThread.setObjectName(QStringLiteral("XRecord"));
+    m_recordingThread.start();
 
     connect(m_window.data(), &ContentsWindow::mirrorWindowClosed,
             this, &XwaylandVideoBridge::closeSession);
 
+    connect(qApp, &QCoreApplication::aboutToQuit,
+            this, &XwaylandVideoBridge::closeSession);
+
+    m_window->show();
+
+    // The tray icon pulls in the widget machinery and talks to the
+    // StatusNotifierWatcher, exporting memory usage needs the session bus.
+    // None of it is needed for the bridge window to exist, so keep it out of
+    // the login rush: it happens with the first session, or once things have
+    // settled down.
+    QTimer::singleShot(s_deferredSetupDelay, this, [this]() {
+        ensureTrayIcon();
+        exportMemoryUsage();
+    });
+}
+
+XwaylandVideoBridge::~XwaylandVideoBridge()
+{
+    // The exporter's worker reports to m_memory until it is gone
+    delete m_frameExporter;
+
+    // The notifier gets deleted on its own thread as that finishes
+    m_recordingThread.quit();
+    m_recordingThread.wait();
+}
+
+void XwaylandVideoBridge::setMemoryBudget(qint64 bytes)
+{
+    m_memory->setBudget(bytes);
+}
+
+void XwaylandVideoBridge::setFrameExportEnabled(bool enabled)
+{
+    if (enabled == bool(m_frameExporter))
+        return;
+
+    if (!enabled) {
+        delete m_frameExporter;
+        m_frameExporter = nullptr;
+        return;
+    }
+
+    m_frameExporter = new FrameExporter(m_memory, this);
+    if (m_pipeWireItem)
+        m_frameExporter->setStream(fcntl(m_pipeWireFd, F_DUPFD_CLOEXEC, 0), m_nodeId);
+}
+
+OrgFreedesktopPortalScreenCastInterface *XwaylandVideoBridge::portal()
+{
+    if (!iface) {
+        iface = new OrgFreedesktopPortalScreenCastInterface(
+            QLatin1String("org.freedesktop.portal.Desktop"),
+            QLatin1String("/org/freedesktop/portal/desktop"),
+            QDBusConnection::sessionBus(), this);
+    }
+    return iface;
+}
+
+void XwaylandVideoBridge::ensureTrayIcon()
+{
+    if (m_trayIcon)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
     m_trayIcon = new KStatusNotifierItem(this);
     m_trayIcon->setIconByName(QStringLiteral("xwaylandvideobridge"));
     m_trayIcon->setTitle(i18n("Wayland to X11 Video Bridge"));
@@ -135,26 +237,67 @@ XwaylandVideoBridge::XwaylandVideoBridge(QObject *parent)
     });
     m_trayIcon->setContextMenu(menu);
 
-    connect(qApp, &QCoreApplication::aboutToQuit,
-            this, &XwaylandVideoBridge::closeSession);
+    if (m_sessionActive)
+        m_trayIcon->setStatus(KStatusNotifierItem::Active);
 
-    m_window->show();
+    qCDebug(XWAYLANDBRIDGE) << "Tray icon created in" << timer.elapsed() << "ms";
 }
 
-XwaylandVideoBridge::~XwaylandVideoBridge() = default;
+void XwaylandVideoBridge::exportMemoryUsage()
+{
+    if (m_memoryUsageExported)
+        return;
+    m_memoryUsageExported = true;
+
+    // So memory usage can be asked for with e.g.
+    // qdbus org.kde.xwaylandvideobridge /MemoryUsage report
+    auto bus = QDBusConnection::sessionBus();
+    if (!bus.registerObject(QStringLiteral("/MemoryUsage"), m_memory,
+                            QDBusConnection::ExportScriptableSlots)) {
+        qCWarning(XWAYLANDBRIDGE) << "Could not export memory usage on D-Bus"
+                                  << bus.lastError().message();
+        return;
+    }
+
+    // Nothing waits for the name, don't block on the bus for it
+    constexpr uint doNotQueue = 4; // DBUS_NAME_FLAG_DO_NOT_QUEUE
+    auto watcher = new QDBusPendingCallWatcher(
+        bus.interface()->asyncCall(QStringLiteral("RequestName"),
+                                   QStringLiteral("org.kde.xwaylandvideobridge"),
+                                   doNotQueue),
+        this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this,
+            [bus](QDBusPendingCallWatcher *watcher) {
+                watcher->deleteLater();
+                const QDBusPendingReply<uint> reply = *watcher;
+                // 1 is DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER
+                if (reply.isError() || reply.value() != 1) {
+                    qCWarning(XWAYLANDBRIDGE) << "Could not register D-Bus service, memory usage"
+                                              << "is only available on" << bus.baseService()
+                                              << reply.error().message();
+                }
+            });
+}
 
 void XwaylandVideoBridge::closeSession()
 {
     m_sessionActive = false;
-    m_trayIcon->setStatus(KStatusNotifierItem::Passive);
+    if (m_trayIcon)
+        m_trayIcon->setStatus(KStatusNotifierItem::Passive);
 
     if (m_pipeWireItem) {
-        disconnect(m_pipeWireItem, nullptr, this, nullptr);
-        m_pipeWireItem->deleteLater();
+        deleteSourceItem(m_pipeWireItem);
         m_pipeWireItem = nullptr;
     }
+    m_memory->set(MemoryBudget::StreamTexture, 0);
+    if (m_frameExporter)
+        m_frameExporter->stop();
 
     m_quitTimer->stop();
+    m_watchdog->stop();
+    m_recovery = Recovery::None;
+    m_stallTimer.invalidate();
+    closePipeWireFd();
 
     if (!m_path.path().isEmpty()) {
         QDBusConnection::sessionBus().disconnect(
@@ -184,7 +327,7 @@ void XwaylandVideoBridge::startStream(const QDBusObjectPath &path)
                                           QLatin1String("Closed"), this, SLOT(closeSession()));
 
     CursorModes availableCursorModes =
-    static_cast<CursorModes>(iface->availableCursorModes());
+    static_cast<CursorModes>(portal()->availableCursorModes());
     CursorMode cursorMode = CursorMode::Hidden;
     if (availableCursorModes.testFlag(CursorMode::Metadata)) {
         cursorMode = CursorMode::Metadata;
@@ -197,11 +340,11 @@ void XwaylandVideoBridge::startStream(const QDBusObjectPath &path)
 
     const QVariantMap sourcesParameters = {
         {QLatin1String("handle_token"), m_handleToken},
-        {QLatin1String("types"), iface->availableSourceTypes()},
+        {QLatin1String("types"), portal()->availableSourceTypes()},
         {QLatin1String("multiple"), false},
         {QLatin1String("cursor_mode"), static_cast<uint>(cursorMode)}};
 
-        auto reply = iface->SelectSources(m_path, sourcesParameters);
+        auto reply = portal()->SelectSources(m_path, sourcesParameters);
         reply.waitForFinished();
 
         if (reply.isError()) {
@@ -242,13 +385,15 @@ void XwaylandVideoBridge::response(uint code, const QVariantMap &results)
 void XwaylandVideoBridge::init()
 {
     m_sessionActive = true;
+    ensureTrayIcon();
+    exportMemoryUsage();
     m_trayIcon->setStatus(KStatusNotifierItem::Active);
 
     const QVariantMap sessionParameters = {
         {QLatin1String("session_handle_token"), m_handleToken},
         {QLatin1String("handle_token"), m_handleToken}};
 
-        auto sessionReply = iface->CreateSession(sessionParameters);
+        auto sessionReply = portal()->CreateSession(sessionParameters);
         sessionReply.waitForFinished();
         if (!sessionReply.isValid()) {
             qCWarning(XWAYLANDBRIDGE) << "Couldn't initialize the screencast session";
@@ -275,7 +420,7 @@ void XwaylandVideoBridge::start()
     const QVariantMap startParameters = {
         {QLatin1String("handle_token"), m_handleToken}};
 
-        auto reply = iface->Start(
+        auto reply = portal()->Start(
             m_path,
             QStringLiteral("x11:%1").arg(QString::number(m_window->winId(), 16)),
                                   startParameters);
@@ -295,50 +440,203 @@ void XwaylandVideoBridge::handleStreams(const QVector<Stream> &streams)
         return;
     }
 
+    const int fd = openPipeWireRemote();
+    if (fd < 0) {
+        exit(1);
+        return;
+    }
+    closePipeWireFd();
+    m_pipeWireFd = fd;
+    m_nodeId = streams[0].nodeId;
+
+    m_window->setTitle(streamTitle(streams[0]));
+
+    createSourceItem();
+}
+
+int XwaylandVideoBridge::openPipeWireRemote()
+{
     const QVariantMap startParameters = {
         {QLatin1String("handle_token"), m_handleToken}};
 
-        auto reply = iface->OpenPipeWireRemote(m_path, startParameters);
-        reply.waitForFinished();
+    auto reply = portal()->OpenPipeWireRemote(m_path, startParameters);
+    reply.waitForFinished();
 
-        if (reply.isError()) {
-            qCWarning(XWAYLANDBRIDGE)
+    if (reply.isError()) {
+        qCWarning(XWAYLANDBRIDGE)
             << "Could not open PipeWire remote:" << reply.error();
-            exit(1);
-            return;
-        }
-        const int fd = reply.value().takeFileDescriptor();
-
-        m_window->setTitle(streamTitle(streams[0]));
-
-        m_pipeWireItem = new PipeWireSourceItem(m_window->contentItem());
-        m_pipeWireItem->setFd(fd);
-        m_pipeWireItem->setNodeId(streams[0].nodeId);
-        m_pipeWireItem->setVisible(true);
-        m_pipeWireItem->setPosition(QPointF(0, 0));
-
-        connect(m_pipeWireItem, &PipeWireSourceItem::streamSizeChanged, this, [this]() {
-            if (!m_pipeWireItem)
-                return;
-            const QSize s = m_pipeWireItem->streamSize();
-            if (!s.isEmpty())
-                m_pipeWireItem->setSize(QSizeF(s));
-        });
-        // Set initial size in case streamSize is already known
-        const QSize initial = m_pipeWireItem->streamSize();
-        if (!initial.isEmpty())
-            m_pipeWireItem->setSize(QSizeF(initial));
-
-    connect(m_pipeWireItem, &PipeWireSourceItem::stateChanged, this, [this]() {
+        return -1;
+    }
+    return reply.value().takeFileDescriptor();
+}
+
+void XwaylandVideoBridge::closePipeWireFd()
+{
+    if (m_pipeWireFd >= 0) {
+        ::close(m_pipeWireFd);
+        m_pipeWireFd = -1;
+    }
+}
+
+void XwaylandVideoBridge::deleteSourceItem(PipeWireSourceItem *item)
+{
+    disconnect(item, nullptr, this, nullptr);
+    item->setVisible(false);
+    item->deleteLater();
+}
+
+void XwaylandVideoBridge::createSourceItem()
+{
+    if (m_pipeWireItem)
+        deleteSourceItem(m_pipeWireItem);
+
+    // PipeWire takes ownership of the fd it connects with. Hand it a copy so
+    // the node can be reconnected later without going back to the portal.
+    m_pipeWireItem = new PipeWireSourceItem(m_window->contentItem());
+    m_pipeWireItem->setFd(fcntl(m_pipeWireFd, F_DUPFD_CLOEXEC, 0));
+    m_pipeWireItem->setNodeId(m_nodeId);
+    m_pipeWireItem->setVisible(true);
+    m_pipeWireItem->setPosition(QPointF(0, 0));
+
+    connect(m_pipeWireItem, &PipeWireSourceItem::streamSizeChanged, this, [this]() {
         if (!m_pipeWireItem)
             return;
+        const QSize s = m_pipeWireItem->streamSize();
+        if (!s.isEmpty())
+            m_pipeWireItem->setSize(QSizeF(s));
+        m_memory->set(MemoryBudget::StreamTexture, qint64(s.width()) * s.height() * 4);
+    });
+    // Set initial size in case streamSize is already known
+    const QSize initial = m_pipeWireItem->streamSize();
+    if (!initial.isEmpty())
+        m_pipeWireItem->setSize(QSizeF(initial));
+    m_memory->set(MemoryBudget::StreamTexture, qint64(initial.width()) * initial.height() * 4);
+
+    connect(m_pipeWireItem, &PipeWireSourceItem::stateChanged,
+            this, &XwaylandVideoBridge::checkStream);
+    // Only becomes ready once a buffer made it into a texture
+    connect(m_pipeWireItem, &PipeWireSourceItem::readyChanged,
+            this, &XwaylandVideoBridge::checkStream);
+
+    if (m_frameExporter)
+        m_frameExporter->setStream(fcntl(m_pipeWireFd, F_DUPFD_CLOEXEC, 0), m_nodeId);
+
+    // A freshly connected stream always delivers a first buffer, so arm the
+    // watchdog until it does.
+    armWatchdog();
+}
+
+void XwaylandVideoBridge::armWatchdog()
+{
+    if (!m_stallTimer.isValid())
+        m_stallTimer.start();
+    if (!m_watchdog->isActive())
+        m_watchdog->start();
+}
 
-        const auto state = m_pipeWireItem->state();
+void XwaylandVideoBridge::checkStream()
+{
+    if (!m_pipeWireItem)
+        return;
+
+    // Screencast streams are damage driven, a static source legitimately
+    // stops producing buffers, and a paused one (e.g. a minimized window)
+    // resumes by itself. Only treat silence as a stall if the stream broke
+    // off or never produced anything at all.
+    if (!isStalled()) {
+        streamHealthy();
+        return;
+    }
+
+    armWatchdog();
+}
 
-        if (state == PipeWireSourceItem::StreamState::Streaming)
+bool XwaylandVideoBridge::isStalled() const
+{
+    switch (m_pipeWireItem->state()) {
+    case PipeWireSourceItem::StreamState::Paused:
+        return false;
+    case PipeWireSourceItem::StreamState::Streaming:
+        return !m_pipeWireItem->isReady();
+    default:
+        return true;
+    }
+}
+
+void XwaylandVideoBridge::streamHealthy()
+{
+    m_watchdog->stop();
+
+    if (m_recovery != Recovery::None) {
+        qCInfo(XWAYLANDBRIDGE) << "Stream" << m_nodeId << "recovered by"
+                               << m_recovery << "after"
+                               << m_stallTimer.elapsed() << "ms";
+    }
+    m_recovery = Recovery::None;
+    m_stallTimer.invalidate();
+}
+
+void XwaylandVideoBridge::recoverStream()
+{
+    if (!m_pipeWireItem) {
+        m_watchdog->stop();
+        return;
+    }
+
+    if (!isStalled()) {
+        streamHealthy();
+        return;
+    }
+
+    const auto state = m_pipeWireItem->state();
+    switch (m_recovery) {
+    case Recovery::None:
+        m_recovery = Recovery::ReconnectNode;
+        qCWarning(XWAYLANDBRIDGE) << "Stream" << m_nodeId << "stalled in state"
+                                  << state << "for" << m_stallTimer.elapsed()
+                                  << "ms, reconnecting node";
+        createSourceItem();
+        return;
+    case Recovery::ReconnectNode: {
+        m_recovery = Recovery::ReopenRemote;
+        qCWarning(XWAYLANDBRIDGE) << "Stream" << m_nodeId << "still stalled after"
+                                  << m_stallTimer.elapsed()
+                                  << "ms, reopening PipeWire remote";
+        const int fd = openPipeWireRemote();
+        if (fd >= 0) {
+            closePipeWireFd();
+            m_pipeWireFd = fd;
+            createSourceItem();
             return;
+        }
+        break;
+    }
+    case Recovery::ReopenRemote:
+        break;
+    case Recovery::RecreateSession:
+        qCWarning(XWAYLANDBRIDGE) << "Stream" << m_nodeId
+                                  << "stalled in a new session, giving up";
+        closeSession();
+        return;
+    }
 
-        if (state == PipeWireSourceItem::StreamState::Unconnected)
-            closeSession();
-    });
+    // A new session means a new portal prompt. That is only worth it while
+    // somebody still wants to see the window, a source that is gone for good
+    // (e.g. the shared window got closed) just ends the session.
+    if (!m_redirected) {
+        qCInfo(XWAYLANDBRIDGE) << "Stream" << m_nodeId << "lost after"
+                               << m_stallTimer.elapsed()
+                               << "ms and nobody is recording, closing the session";
+        closeSession();
+        return;
+    }
+
+    qCWarning(XWAYLANDBRIDGE) << "Stream" << m_nodeId << "still stalled after"
+                              << m_stallTimer.elapsed()
+                              << "ms, recreating screencast session";
+    const QElapsedTimer stallTimer = m_stallTimer;
+    closeSession();
+    m_recovery = Recovery::RecreateSession;
+    m_stallTimer = stallTimer;
+    init();
 }
@@ -9,10 +9,15 @@
 #include <KStatusNotifierItem>
 #include <PipeWireRecord>
 #include <QDBusObjectPath>
+#include <QElapsedTimer>
 #include <QObject>
+#include <QThread>
 
 class QTimer;
 class ContentsWindow;
+class FrameExporter;
+class X11RecordingNotifier;
+class MemoryBudget;
 class PipeWireSourceItem;
 
 struct Stream {
@@ -35,6 +40,19 @@ public:
     enum SourceTypes { Monitor = 1, Window = 2, Virtual = 4 };
     Q_ENUM(SourceTypes)
 
+    // Escalating steps taken when a stream stops delivering buffers
+    enum class Recovery { None, ReconnectNode, ReopenRemote, RecreateSession };
+    Q_ENUM(Recovery)
+
+    /// Export the bridged frames to local tools, see xwaylandvideobridge-frames.h
+    void setFrameExportEnabled(bool enabled);
+
+    /// Creates the tray icon, unless it exists already
+    void ensureTrayIcon();
+
+    /// Budget the frame export has to fit in next to the window and stream, 0 means unlimited
+    void setMemoryBudget(qint64 bytes);
+
 public Q_SLOTS:
     void response(uint code, const QVariantMap &results);
 
@@ -43,17 +61,39 @@ private Q_SLOTS:
 
 private:
     void init();
+    OrgFreedesktopPortalScreenCastInterface *portal();
+    void exportMemoryUsage();
     void startStream(const QDBusObjectPath &path);
     void handleStreams(const QVector<Stream> &streams);
     void start();
+    int openPipeWireRemote();
+    void closePipeWireFd();
+    void createSourceItem();
+    void deleteSourceItem(PipeWireSourceItem *item);
+    void armWatchdog();
+    void checkStream();
+    bool isStalled() const;
+    void streamHealthy();
+    void recoverStream();
 
-    OrgFreedesktopPortalScreenCastInterface *iface;
+    OrgFreedesktopPortalScreenCastInterface *iface = nullptr;
     QDBusObjectPath m_path;
     QString m_handleToken;
 
     QTimer *m_quitTimer;
+    QThread m_recordingThread;
+    X11RecordingNotifier *m_notifier = nullptr;
+    bool m_redirected = false;
     QScopedPointer<ContentsWindow> m_window;
+    QTimer *m_watchdog;
+    QElapsedTimer m_stallTimer;
+    Recovery m_recovery = Recovery::None;
     PipeWireSourceItem *m_pipeWireItem = nullptr;
+    int m_pipeWireFd = -1;
+    uint m_nodeId = 0;
     KStatusNotifierItem *m_trayIcon = nullptr;
+    FrameExporter *m_frameExporter = nullptr;
+    MemoryBudget *m_memory;
     bool m_sessionActive = false;
+    bool m_memoryUsageExported = false;
 };